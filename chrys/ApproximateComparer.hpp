@@ -55,7 +55,7 @@ namespace chrys
 
         bool Zero(const TScalar d) const
         {
-            return d > _negEps && d < _eps;
+            return (d > _negEps) & (d < _eps);
         }
 
         template<typename TVector>
@@ -0,0 +1,754 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <glm/glm.hpp>
+#include "ApproximateComparer.hpp"
+
+namespace chrys
+{
+    /// <summary>
+    /// Decides which tile owns geometry lying (within eps) on the max edge of a rectangle.
+    /// Min edges are always inside.
+    /// Closed: the max edges are inside too (viewport culling).
+    /// HalfOpen: the max edges belong to the neighboring rectangle,
+    /// so a segment on a shared tile edge is emitted by exactly one of the tiles.
+    /// </summary>
+    enum class ClipEdges
+    {
+        Closed,
+        HalfOpen
+    };
+
+    /// <summary>
+    /// Non-owning structure-of-arrays view of 2D line segments:
+    /// segment i is (X0[i], Y0[i]) -> (X1[i], Y1[i]).
+    /// </summary>
+    template<typename _TScalar>
+    struct SegmentArrays
+    {
+        typedef _TScalar TScalar;
+
+        const TScalar* X0;
+        const TScalar* Y0;
+        const TScalar* X1;
+        const TScalar* Y1;
+        std::size_t Count;
+    };
+
+    /// <summary>
+    /// Compacted clipping output in structure-of-arrays layout.
+    /// Source[i] is the index of the input segment the i-th clipped segment was cut from.
+    /// Tile[i] is the linear tile index (row * Columns + column) in grid mode, and stays empty otherwise.
+    /// Results are appended, so the same instance can be reused to avoid reallocations.
+    /// Don't mix grid and single rectangle results in one instance, it would leave Tile out of sync.
+    /// </summary>
+    template<typename _TScalar>
+    struct ClippedSegments
+    {
+        typedef _TScalar TScalar;
+
+        std::vector<TScalar> X0;
+        std::vector<TScalar> Y0;
+        std::vector<TScalar> X1;
+        std::vector<TScalar> Y1;
+        std::vector<std::uint32_t> Source;
+        std::vector<std::uint32_t> Tile;
+
+        std::size_t Size() const { return Source.size(); }
+
+        void Clear()
+        {
+            X0.clear();
+            Y0.clear();
+            X1.clear();
+            Y1.clear();
+            Source.clear();
+            Tile.clear();
+        }
+    };
+
+    template<typename _TScalar>
+    struct ClipRect
+    {
+        typedef _TScalar TScalar;
+
+        TScalar MinX;
+        TScalar MinY;
+        TScalar MaxX;
+        TScalar MaxY;
+    };
+
+    /// <summary>
+    /// Regular grid of Columns x Rows tiles of size (TileWidth, TileHeight), starting at (OriginX, OriginY).
+    /// Tiles are half-open towards their neighbors, the outer max edges of the grid are closed.
+    /// </summary>
+    template<typename _TScalar>
+    struct TileGrid
+    {
+        typedef _TScalar TScalar;
+
+        TScalar OriginX;
+        TScalar OriginY;
+        TScalar TileWidth;
+        TScalar TileHeight;
+        std::uint32_t Columns;
+        std::uint32_t Rows;
+
+        /// <summary>
+        /// Coordinate of the boundary between column (i-1) and i.
+        /// Neighboring tiles must get bitwise identical edges, so always compute them here.
+        /// </summary>
+        TScalar EdgeX(const std::uint32_t i) const { return OriginX + static_cast<TScalar>(i) * TileWidth; }
+
+        TScalar EdgeY(const std::uint32_t i) const { return OriginY + static_cast<TScalar>(i) * TileHeight; }
+
+        ClipRect<TScalar> Tile(const std::uint32_t column, const std::uint32_t row) const
+        {
+            return { EdgeX(column), EdgeY(row), EdgeX(column + 1), EdgeY(row + 1) };
+        }
+    };
+
+    namespace detail
+    {
+        /// <summary>
+        /// Approximate [lo, hi] (or [lo, hi) if !includeHi) test used for axes the segment is parallel to.
+        /// The half-open max test is the exact negation of the neighbor's min test, so ties at (edge - eps) have exactly one owner.
+        /// Combined with bitwise operators instead of branches, so it can be evaluated on vector lanes.
+        /// </summary>
+        template<typename TScalar>
+        inline bool MidInside(
+            const ApproximateComparer<TScalar>& apx,
+            const TScalar mid, const TScalar lo, const TScalar hi,
+            const bool includeHi)
+        {
+            const bool aboveLo = apx.GE(mid, lo);
+            const bool belowHi = (includeHi & apx.LE(mid, hi)) | (!includeHi & !apx.GE(mid, hi));
+            return aboveLo & belowHi;
+        }
+
+        /// <summary>
+        /// Combine the parameters t of the segment hitting the lo and hi edges of one axis
+        /// into the entering and exiting parameters. Returns false if the axis rejects the segment.
+        /// (Results are passed through scalars instead of a struct, a struct holding a bool is kept in memory
+        /// by GCC, which prevents vectorization.)
+        /// </summary>
+        template<typename TScalar>
+        inline bool AxisFromEdges(
+            const bool parallel,
+            const TScalar tLo, const TScalar tHi,
+            const bool midInside,
+            TScalar& tEnter, TScalar& tExit)
+        {
+            const TScalar tMin = glm::min(tLo, tHi);
+            const TScalar tMax = glm::max(tLo, tHi);
+            tEnter = parallel ? TScalar(0) : tMin;
+            tExit = parallel ? TScalar(1) : tMax;
+            return !parallel | midInside;
+        }
+
+        /// <summary>
+        /// Liang-Barsky slab test of the parametric segment p(t) = p0 + t*d against [lo, hi] on one axis.
+        /// Axes where d is zero according to the comparer are decided by the (approximate) position of the midpoint,
+        /// so segments lying on a tile edge are classified the same way by both neighbors.
+        /// </summary>
+        template<typename TScalar>
+        inline bool ClipAxis(
+            const ApproximateComparer<TScalar>& apx,
+            const TScalar p0, const TScalar p1,
+            const TScalar lo, const TScalar hi,
+            const bool includeHi,
+            TScalar& tEnter, TScalar& tExit)
+        {
+            const TScalar d = p1 - p0;
+            const bool parallel = apx.Zero(d);
+            const TScalar safeD = parallel ? TScalar(1) : d;
+
+            const TScalar tLo = (lo - p0) / safeD;
+            const TScalar tHi = (hi - p0) / safeD;
+
+            const TScalar mid = (p0 + p1) * TScalar(0.5);
+            return AxisFromEdges(parallel, tLo, tHi, MidInside(apx, mid, lo, hi, includeHi), tEnter, tExit);
+        }
+
+        /// <summary>
+        /// Intersect the parameter ranges of both axes with [0, 1] and decide if the piece is kept.
+        /// </summary>
+        template<typename TScalar>
+        inline bool Accept(
+            const ApproximateComparer<TScalar>& apx,
+            const bool insideX, const TScalar enterX, const TScalar exitX,
+            const bool insideY, const TScalar enterY, const TScalar exitY,
+            const TScalar length2,
+            TScalar& t0, TScalar& t1)
+        {
+            t0 = glm::max(TScalar(0), glm::max(enterX, enterY));
+            t1 = glm::min(TScalar(1), glm::min(exitX, exitY));
+
+            const TScalar dt = t1 - t0;
+            const bool point = length2 < apx.Eps2();
+            const bool longEnough = length2 * dt * dt >= apx.Eps2();
+
+            return insideX & insideY & (t0 <= t1) & (point | longEnough);
+        }
+
+        /// <summary>
+        /// True if all coordinates are finite. Written as x - x == 0, which is false for infinities and NaN,
+        /// and vectorizes, unlike std::isfinite.
+        /// </summary>
+        template<typename TScalar>
+        inline bool Finite(const TScalar x0, const TScalar y0, const TScalar x1, const TScalar y1)
+        {
+            return (x0 - x0 == TScalar(0)) & (y0 - y0 == TScalar(0)) & (x1 - x1 == TScalar(0)) & (y1 - y1 == TScalar(0));
+        }
+
+        template<typename TScalar>
+        inline TScalar Lerp(const TScalar a, const TScalar b, const TScalar t)
+        {
+            // Exact for t = 0 and t = 1 without selects (also when contracted to FMA):
+            // original endpoints stay bitwise exact, so pieces of the same segment stay connected.
+            return (TScalar(1) - t) * a + t * b;
+        }
+    }
+
+    /// <summary>
+    /// Clip a single segment against a rectangle.
+    /// Clipped pieces shorter than eps are dropped (eg. a segment only touching a corner),
+    /// unless the input segment itself is shorter than eps, in which case it's treated as a point.
+    /// Segments with non-finite coordinates are rejected.
+    /// Returns true and writes the clipped parameter range [t0, t1] if anything is left.
+    /// </summary>
+    template<typename TScalar>
+    inline bool ClipSegment(
+        const ApproximateComparer<TScalar>& apx,
+        const TScalar x0, const TScalar y0, const TScalar x1, const TScalar y1,
+        const ClipRect<TScalar>& rect,
+        const bool includeMaxX, const bool includeMaxY,
+        TScalar& t0, TScalar& t1)
+    {
+        TScalar enterX, exitX, enterY, exitY;
+        const bool insideX = detail::ClipAxis(apx, x0, x1, rect.MinX, rect.MaxX, includeMaxX, enterX, exitX);
+        const bool insideY = detail::ClipAxis(apx, y0, y1, rect.MinY, rect.MaxY, includeMaxY, enterY, exitY);
+
+        const TScalar dx = x1 - x0;
+        const TScalar dy = y1 - y0;
+
+        return detail::Finite(x0, y0, x1, y1) &
+            detail::Accept(apx, insideX, enterX, exitX, insideY, enterY, exitY, dx * dx + dy * dy, t0, t1);
+    }
+
+    template<typename TScalar>
+    inline bool ClipSegment(
+        const ApproximateComparer<TScalar>& apx,
+        const TScalar x0, const TScalar y0, const TScalar x1, const TScalar y1,
+        const ClipRect<TScalar>& rect,
+        const ClipEdges edges,
+        TScalar& t0, TScalar& t1)
+    {
+        const bool includeMax = edges == ClipEdges::Closed;
+        return ClipSegment(apx, x0, y0, x1, y1, rect, includeMax, includeMax, t0, t1);
+    }
+
+    namespace detail
+    {
+        constexpr std::size_t ClipBlockSize = 64;
+
+        /// <summary>
+        /// Clip one block of segments, writing the clipped endpoints and a 0/1 keep mask for every input.
+        /// Both loops are free of branches and calls after inlining, and are vectorized by GCC -O3
+        /// (verify with -fopt-info-vec). The interpolation has its own loop: fused into the first one,
+        /// jump threading on the clamped parameters moves floating point ops under a branch,
+        /// which -ftrapping-math (the default) doesn't allow to if-convert back.
+        /// </summary>
+        template<bool IncludeMax, typename TScalar>
+        inline void ClipBlock(
+            const ApproximateComparer<TScalar>& apx,
+            const ClipRect<TScalar>& rect,
+            const TScalar* x0, const TScalar* y0, const TScalar* x1, const TScalar* y1,
+            const std::size_t count,
+            TScalar* t0, TScalar* t1, TScalar* keep,
+            TScalar* cx0, TScalar* cy0, TScalar* cx1, TScalar* cy1)
+        {
+            for (std::size_t i = 0; i < count; i++)
+            {
+                // Load every input once, otherwise the possibly aliasing stores below force reloads.
+                const TScalar ax = x0[i];
+                const TScalar ay = y0[i];
+                const TScalar bx = x1[i];
+                const TScalar by = y1[i];
+
+                TScalar s0, s1;
+                const bool accepted = ClipSegment(apx, ax, ay, bx, by, rect, IncludeMax, IncludeMax, s0, s1);
+
+                t0[i] = s0;
+                t1[i] = s1;
+                keep[i] = accepted ? TScalar(1) : TScalar(0);
+            }
+
+            for (std::size_t i = 0; i < count; i++)
+            {
+                const TScalar ax = x0[i];
+                const TScalar ay = y0[i];
+                const TScalar bx = x1[i];
+                const TScalar by = y1[i];
+
+                cx0[i] = Lerp(ax, bx, t0[i]);
+                cy0[i] = Lerp(ay, by, t0[i]);
+                cx1[i] = Lerp(ax, bx, t1[i]);
+                cy1[i] = Lerp(ay, by, t1[i]);
+            }
+        }
+
+        template<bool IncludeMax, typename TScalar>
+        std::size_t ClipSegments(
+            const ApproximateComparer<TScalar>& apx,
+            const SegmentArrays<TScalar>& segments,
+            const ClipRect<TScalar>& rect,
+            ClippedSegments<TScalar>& output)
+        {
+            const std::size_t start = output.Size();
+            output.X0.resize(start + segments.Count);
+            output.Y0.resize(start + segments.Count);
+            output.X1.resize(start + segments.Count);
+            output.Y1.resize(start + segments.Count);
+            output.Source.resize(start + segments.Count);
+
+            TScalar cx0[ClipBlockSize];
+            TScalar cy0[ClipBlockSize];
+            TScalar cx1[ClipBlockSize];
+            TScalar cy1[ClipBlockSize];
+            TScalar keep[ClipBlockSize];
+            TScalar t0[ClipBlockSize];
+            TScalar t1[ClipBlockSize];
+
+            std::size_t n = start;
+
+            for (std::size_t blockStart = 0; blockStart < segments.Count; blockStart += ClipBlockSize)
+            {
+                const std::size_t blockCount = std::min(ClipBlockSize, segments.Count - blockStart);
+
+                ClipBlock<IncludeMax>(
+                    apx, rect,
+                    segments.X0 + blockStart, segments.Y0 + blockStart, segments.X1 + blockStart, segments.Y1 + blockStart,
+                    blockCount,
+                    t0, t1, keep,
+                    cx0, cy0, cx1, cy1);
+
+                // Compaction stores to data dependent positions, this part stays scalar:
+                for (std::size_t i = 0; i < blockCount; i++)
+                {
+                    output.X0[n] = cx0[i];
+                    output.Y0[n] = cy0[i];
+                    output.X1[n] = cx1[i];
+                    output.Y1[n] = cy1[i];
+                    output.Source[n] = static_cast<std::uint32_t>(blockStart + i);
+                    n += static_cast<std::size_t>(keep[i]);
+                }
+            }
+
+            output.X0.resize(n);
+            output.Y0.resize(n);
+            output.X1.resize(n);
+            output.Y1.resize(n);
+            output.Source.resize(n);
+
+            return n - start;
+        }
+    }
+
+    /// <summary>
+    /// Clip all segments against one rectangle, appending the surviving pieces and their source indices to 'output'.
+    /// Segments are processed in fixed size blocks: a vectorized pass clips the whole block,
+    /// then a scalar pass compacts the accepted ones. Segments with non-finite coordinates are skipped.
+    /// Returns the number of appended segments.
+    /// </summary>
+    template<typename TScalar>
+    std::size_t ClipSegments(
+        const ApproximateComparer<TScalar>& apx,
+        const SegmentArrays<TScalar>& segments,
+        const ClipRect<TScalar>& rect,
+        const ClipEdges edges,
+        ClippedSegments<TScalar>& output)
+    {
+        if (segments.Count > UINT32_MAX) throw std::invalid_argument("segments");
+
+        return edges == ClipEdges::Closed ?
+            detail::ClipSegments<true>(apx, segments, rect, output) :
+            detail::ClipSegments<false>(apx, segments, rect, output);
+    }
+
+    namespace detail
+    {
+        /// <summary>
+        /// Conservative range of tile indices [first, last] whose cells may touch [lo, hi] (expanded by eps).
+        /// Returns false if the range is outside the grid, or not a number.
+        /// </summary>
+        template<typename TScalar>
+        inline bool TileRange(
+            const ApproximateComparer<TScalar>& apx,
+            TScalar lo, TScalar hi,
+            const TScalar origin, const TScalar size, const std::uint32_t count,
+            std::uint32_t& first, std::uint32_t& last)
+        {
+            const TScalar a = glm::floor((lo - apx.Eps() - origin) / size);
+            const TScalar b = glm::floor((hi + apx.Eps() - origin) / size);
+
+            // Written negated, so NaN bounds are rejected too:
+            if (!(b >= TScalar(0)) || !(a < static_cast<TScalar>(count))) return false;
+
+            first = a < TScalar(0) ? 0 : static_cast<std::uint32_t>(a);
+            last = b >= static_cast<TScalar>(count) ? count - 1 : static_cast<std::uint32_t>(b);
+            return true;
+        }
+    }
+
+    namespace detail
+    {
+        template<typename TScalar>
+        inline void ResizeOutput(ClippedSegments<TScalar>& output, const std::size_t size)
+        {
+            output.X0.resize(size);
+            output.Y0.resize(size);
+            output.X1.resize(size);
+            output.Y1.resize(size);
+            output.Source.resize(size);
+            output.Tile.resize(size);
+        }
+
+        /// <summary>
+        /// Branch-free variant of TileRange() for one axis of a segment's bounding box [lo, hi].
+        /// Additionally reports if [lo, hi] lies inside a single tile, more than 2*eps away from its edges.
+        /// Such a segment is accepted whole by that tile, and rejected by all the others.
+        /// </summary>
+        template<typename TScalar>
+        inline void TileSpan(
+            const ApproximateComparer<TScalar>& apx,
+            const TScalar lo, const TScalar hi,
+            const TScalar origin, const TScalar size, const std::int32_t count,
+            std::int32_t& first, std::int32_t& last, bool& valid, bool& interior)
+        {
+            const TScalar eps = apx.Eps();
+            const TScalar n = static_cast<TScalar>(count);
+            const TScalar qLo = (lo - eps - origin) / size;
+            const TScalar qHi = (hi + eps - origin) / size;
+
+            // floor(qHi) >= 0 and floor(qLo) < n, without floor(), which doesn't vectorize:
+            valid = (qHi >= TScalar(0)) & (qLo < n);
+
+            // Clamped to the grid before converting, where truncation is the same as floor():
+            const std::int32_t a = static_cast<std::int32_t>(glm::min(glm::max(TScalar(0), qLo), n - TScalar(1)));
+            const std::int32_t b = static_cast<std::int32_t>(glm::min(glm::max(TScalar(0), qHi), n - TScalar(1)));
+            first = valid ? a : 0;
+            last = valid ? b : 0;
+
+            // Same expression as TileGrid::EdgeX/EdgeY:
+            const TScalar edgeLo = origin + static_cast<TScalar>(a) * size;
+            const TScalar edgeHi = origin + static_cast<TScalar>(a + 1) * size;
+
+            // Both interior conditions (qLo >= 0 and the margin to the edges of tile 'a') folded into one value.
+            // Evaluated up front instead of in a chain of comparisons: the compiler turns such chains into branches,
+            // and moves floating point operations under them, which can't be vectorized with -ftrapping-math.
+            const TScalar margin = glm::min(lo - edgeLo, edgeHi - hi) - TScalar(2) * eps;
+            interior = glm::min(qLo, margin) >= TScalar(0);
+        }
+
+        /// <summary>
+        /// Tile spans of a block of segments, vectorized by GCC -O3.
+        /// interior[i] is the linear index of the tile holding segment i entirely, or -1 if there is no such tile.
+        /// </summary>
+        template<typename TScalar>
+        inline void GridSpans(
+            const ApproximateComparer<TScalar>& apx,
+            const TileGrid<TScalar>& grid,
+            const TScalar* x0, const TScalar* y0, const TScalar* x1, const TScalar* y1,
+            const std::size_t count,
+            std::int32_t* columnFirst, std::int32_t* columnLast, std::int32_t* rowFirst, std::int32_t* rowLast,
+            std::int32_t* valid, std::int32_t* interior)
+        {
+            const std::int32_t columns = static_cast<std::int32_t>(grid.Columns);
+            const std::int32_t rows = static_cast<std::int32_t>(grid.Rows);
+
+            for (std::size_t i = 0; i < count; i++)
+            {
+                // Non-finite coordinates are skipped: glm::min/max would hide a NaN.
+                const bool finite = Finite(x0[i], y0[i], x1[i], y1[i]);
+                const TScalar ax = finite ? x0[i] : TScalar(0);
+                const TScalar ay = finite ? y0[i] : TScalar(0);
+                const TScalar bx = finite ? x1[i] : TScalar(0);
+                const TScalar by = finite ? y1[i] : TScalar(0);
+
+                std::int32_t cf, cl, rf, rl;
+                bool validX, interiorX, validY, interiorY;
+                TileSpan(apx, glm::min(ax, bx), glm::max(ax, bx), grid.OriginX, grid.TileWidth, columns, cf, cl, validX, interiorX);
+                TileSpan(apx, glm::min(ay, by), glm::max(ay, by), grid.OriginY, grid.TileHeight, rows, rf, rl, validY, interiorY);
+
+                columnFirst[i] = cf;
+                columnLast[i] = cl;
+                rowFirst[i] = rf;
+                rowLast[i] = rl;
+                valid[i] = finite & validX & validY;
+                interior[i] = finite & interiorX & interiorY ? rf * columns + cf : -1;
+            }
+        }
+
+        /// <summary>
+        /// Edge coordinates and the segment's parameter t at each of them, for the 'count' tiles starting at 'first'
+        /// (count + 1 edges).
+        /// </summary>
+        template<typename TScalar>
+        inline void EdgeParameters(
+            const TScalar origin, const TScalar size, const std::uint32_t first, const std::uint32_t count,
+            const TScalar p0, const TScalar safeD,
+            TScalar* edges, TScalar* t)
+        {
+            for (std::uint32_t k = 0; k <= count; k++)
+            {
+                // Same expression as TileGrid::EdgeX/EdgeY, neighbors must see bitwise identical edges:
+                edges[k] = origin + static_cast<TScalar>(first + k) * size;
+            }
+
+            for (std::uint32_t k = 0; k <= count; k++)
+            {
+                t[k] = (edges[k] - p0) / safeD;
+            }
+        }
+
+        /// <summary>
+        /// Scratch buffers of ClipSegmentsToGrid(), allocated once per call.
+        /// </summary>
+        template<typename TScalar>
+        struct GridScratch
+        {
+            std::vector<TScalar> ColumnEdges;
+            std::vector<TScalar> ColumnT;
+            std::vector<TScalar> RowEdges;
+            std::vector<TScalar> RowT;
+            std::vector<TScalar> PieceT0;
+            std::vector<TScalar> PieceT1;
+            std::vector<TScalar> Keep;
+
+            GridScratch(const TileGrid<TScalar>& grid) :
+                ColumnEdges(grid.Columns + std::size_t(1)),
+                ColumnT(grid.Columns + std::size_t(1)),
+                RowEdges(grid.Rows + std::size_t(1)),
+                RowT(grid.Rows + std::size_t(1)),
+                PieceT0(grid.Columns),
+                PieceT1(grid.Columns),
+                Keep(grid.Columns)
+            {
+            }
+        };
+
+        /// <summary>
+        /// Bin a segment crossing tile edges into the tiles [columnFirst, columnLast] x [rowFirst, rowLast] it may touch.
+        /// The parameters t at the column and row edges are computed once, each tile only combines the values
+        /// of its own two edges per axis. In each row only the columns overlapping the segment's part
+        /// within the row are visited (all of the segment's columns if it is parallel to the y axis). The per-row column pass is vectorized by GCC -O3, compaction is scalar.
+        /// Returns the new output size.
+        /// (The comparer is taken by value: through a reference its members may alias the scratch buffers,
+        /// and reloading them after every store keeps GCC from vectorizing the column pass.)
+        /// </summary>
+        template<typename TScalar>
+        std::size_t ClipCrossingSegment(
+            const ApproximateComparer<TScalar> apx,
+            const TileGrid<TScalar>& grid,
+            const std::uint32_t source,
+            const TScalar x0, const TScalar y0, const TScalar x1, const TScalar y1,
+            const std::uint32_t segmentColumnFirst, const std::uint32_t segmentColumnLast,
+            const std::uint32_t rowFirst, const std::uint32_t rowLast,
+            GridScratch<TScalar>& scratch,
+            ClippedSegments<TScalar>& output,
+            std::size_t n)
+        {
+            const std::uint32_t lastColumn = grid.Columns - 1;
+            const std::uint32_t lastRow = grid.Rows - 1;
+
+            const TScalar dx = x1 - x0;
+            const TScalar dy = y1 - y0;
+            const bool parallelX = apx.Zero(dx);
+            const bool parallelY = apx.Zero(dy);
+            const TScalar midX = (x0 + x1) * TScalar(0.5);
+            const TScalar midY = (y0 + y1) * TScalar(0.5);
+            const TScalar length2 = dx * dx + dy * dy;
+
+            EdgeParameters(
+                grid.OriginX, grid.TileWidth, segmentColumnFirst, segmentColumnLast - segmentColumnFirst + 1,
+                x0, parallelX ? TScalar(1) : dx,
+                scratch.ColumnEdges.data(), scratch.ColumnT.data());
+            EdgeParameters(
+                grid.OriginY, grid.TileHeight, rowFirst, rowLast - rowFirst + 1,
+                y0, parallelY ? TScalar(1) : dy,
+                scratch.RowEdges.data(), scratch.RowT.data());
+
+            for (std::uint32_t row = rowFirst; row <= rowLast; row++)
+            {
+                const std::uint32_t r = row - rowFirst;
+
+                TScalar enterY, exitY;
+                const bool insideY = AxisFromEdges(
+                    parallelY, scratch.RowT[r], scratch.RowT[r + 1],
+                    MidInside(apx, midY, scratch.RowEdges[r], scratch.RowEdges[r + 1], row == lastRow),
+                    enterY, exitY);
+
+                // Part of the segment within the row, to narrow down the columns:
+                const TScalar s0 = glm::max(TScalar(0), enterY);
+                const TScalar s1 = glm::min(TScalar(1), exitY);
+                if (!insideY || s0 > s1) continue;
+
+                // Columns of a segment parallel to the y axis are decided by the midpoint of the whole segment,
+                // which can lie outside the part within the row: those keep the segment's own column range.
+                std::uint32_t columnFirst = segmentColumnFirst;
+                std::uint32_t columnLast = segmentColumnLast;
+                if (!parallelX)
+                {
+                    const TScalar sx0 = x0 + s0 * dx;
+                    const TScalar sx1 = x0 + s1 * dx;
+
+                    std::uint32_t rowColumnFirst, rowColumnLast;
+                    if (!TileRange(apx, glm::min(sx0, sx1), glm::max(sx0, sx1), grid.OriginX, grid.TileWidth, grid.Columns, rowColumnFirst, rowColumnLast))
+                    {
+                        continue;
+                    }
+
+                    columnFirst = std::max(rowColumnFirst, segmentColumnFirst);
+                    columnLast = std::min(rowColumnLast, segmentColumnLast);
+                    if (columnFirst > columnLast) continue;
+                }
+
+                const std::uint32_t offset = columnFirst - segmentColumnFirst;
+                const std::uint32_t count = columnLast - columnFirst + 1;
+                const TScalar* edges = scratch.ColumnEdges.data() + offset;
+                const TScalar* t = scratch.ColumnT.data() + offset;
+                TScalar* pieceT0 = scratch.PieceT0.data();
+                TScalar* pieceT1 = scratch.PieceT1.data();
+                TScalar* keep = scratch.Keep.data();
+                const std::uint32_t lastInRow = lastColumn - columnFirst;
+
+                for (std::uint32_t k = 0; k < count; k++)
+                {
+                    TScalar enterX, exitX, t0, t1;
+                    const bool insideX = AxisFromEdges(
+                        parallelX, t[k], t[k + 1],
+                        MidInside(apx, midX, edges[k], edges[k + 1], k == lastInRow),
+                        enterX, exitX);
+                    const bool accepted = Accept(apx, insideX, enterX, exitX, true, enterY, exitY, length2, t0, t1);
+
+                    pieceT0[k] = t0;
+                    pieceT1[k] = t1;
+                    keep[k] = accepted ? TScalar(1) : TScalar(0);
+                }
+
+                // Keeps room for the rest of the block as well, see ClipSegmentsToGrid():
+                if (n + count + ClipBlockSize > output.X0.size())
+                {
+                    ResizeOutput(output, std::max(n + count + ClipBlockSize, 2 * output.X0.size()));
+                }
+
+                const std::uint32_t tileStart = row * grid.Columns + columnFirst;
+
+                for (std::uint32_t k = 0; k < count; k++)
+                {
+                    output.X0[n] = Lerp(x0, x1, pieceT0[k]);
+                    output.Y0[n] = Lerp(y0, y1, pieceT0[k]);
+                    output.X1[n] = Lerp(x0, x1, pieceT1[k]);
+                    output.Y1[n] = Lerp(y0, y1, pieceT1[k]);
+                    output.Source[n] = source;
+                    output.Tile[n] = tileStart + k;
+                    n += static_cast<std::size_t>(keep[k]);
+                }
+            }
+
+            return n;
+        }
+    }
+
+    /// <summary>
+    /// Bin every segment into all tiles of the grid it crosses, appending the clipped pieces,
+    /// their source indices and linear tile indices to 'output' in a single pass over the input.
+    /// Segments are processed in fixed size blocks: a vectorized pass computes the tile span of each segment,
+    /// then segments inside a single tile are emitted whole, the rest are binned by detail::ClipCrossingSegment(),
+    /// with cost proportional to the number of tiles actually crossed.
+    /// The accept decisions are the same as clipping against grid.Tile(column, row) alone with ClipSegment().
+    /// Returns the number of appended segments.
+    /// </summary>
+    template<typename TScalar>
+    std::size_t ClipSegmentsToGrid(
+        const ApproximateComparer<TScalar>& apx,
+        const SegmentArrays<TScalar>& segments,
+        const TileGrid<TScalar>& grid,
+        ClippedSegments<TScalar>& output)
+    {
+        if (segments.Count > UINT32_MAX) throw std::invalid_argument("segments");
+        if (!(grid.TileWidth > TScalar(0)) || !(grid.TileHeight > TScalar(0))) throw std::invalid_argument("grid");
+        // Tile indices are converted to TScalar and back, so they must be represented exactly (up to 2^24 for float):
+        const std::uint64_t maxCount = std::min<std::uint64_t>(INT32_MAX, std::uint64_t(1) << std::numeric_limits<TScalar>::digits);
+        if (grid.Columns > maxCount || grid.Rows > maxCount) throw std::invalid_argument("grid");
+        if (static_cast<std::uint64_t>(grid.Columns) * grid.Rows > INT32_MAX) throw std::invalid_argument("grid");
+
+        const std::size_t start = output.Size();
+        if (grid.Columns == 0 || grid.Rows == 0) return 0;
+
+        detail::GridScratch<TScalar> scratch(grid);
+
+        std::int32_t columnFirst[detail::ClipBlockSize];
+        std::int32_t columnLast[detail::ClipBlockSize];
+        std::int32_t rowFirst[detail::ClipBlockSize];
+        std::int32_t rowLast[detail::ClipBlockSize];
+        std::int32_t valid[detail::ClipBlockSize];
+        std::int32_t interior[detail::ClipBlockSize];
+
+        std::size_t n = start;
+
+        for (std::size_t blockStart = 0; blockStart < segments.Count; blockStart += detail::ClipBlockSize)
+        {
+            const std::size_t blockCount = std::min(detail::ClipBlockSize, segments.Count - blockStart);
+            const TScalar* x0 = segments.X0 + blockStart;
+            const TScalar* y0 = segments.Y0 + blockStart;
+            const TScalar* x1 = segments.X1 + blockStart;
+            const TScalar* y1 = segments.Y1 + blockStart;
+
+            detail::GridSpans(
+                apx, grid, x0, y0, x1, y1, blockCount,
+                columnFirst, columnLast, rowFirst, rowLast, valid, interior);
+
+            // Room for one piece per segment of the block, segments inside a single tile are written without checks.
+            // detail::ClipCrossingSegment() grows the output further when needed, keeping this much room.
+            if (n + blockCount > output.X0.size())
+            {
+                detail::ResizeOutput(output, std::max(n + blockCount, 2 * output.X0.size()));
+            }
+
+            for (std::size_t i = 0; i < blockCount; i++)
+            {
+                const std::uint32_t source = static_cast<std::uint32_t>(blockStart + i);
+
+                if (interior[i] >= 0)
+                {
+                    output.X0[n] = x0[i];
+                    output.Y0[n] = y0[i];
+                    output.X1[n] = x1[i];
+                    output.Y1[n] = y1[i];
+                    output.Source[n] = source;
+                    output.Tile[n] = static_cast<std::uint32_t>(interior[i]);
+                    n++;
+                }
+                else if (valid[i])
+                {
+                    n = detail::ClipCrossingSegment(
+                        apx, grid, source, x0[i], y0[i], x1[i], y1[i],
+                        static_cast<std::uint32_t>(columnFirst[i]), static_cast<std::uint32_t>(columnLast[i]),
+                        static_cast<std::uint32_t>(rowFirst[i]), static_cast<std::uint32_t>(rowLast[i]),
+                        scratch, output, n);
+                }
+            }
+        }
+
+        detail::ResizeOutput(output, n);
+
+        return n - start;
+    }
+}
@@ -0,0 +1,451 @@
+#include <vector>
+#include <limits>
+#include <chrys/SegmentClipping.hpp>
+
+#include <catch.hpp>
+#include "TestUtils.hpp"
+
+namespace chrys
+{
+    namespace tests
+    {
+        namespace SegmentClippingTests
+        {
+            template<typename TScalar>
+            struct SegmentClippingFixture
+            {
+                typedef glm::vec<2, TScalar, glm::defaultp> TVector2;
+
+                ApproximateComparer<TScalar> Apx{ static_cast<TScalar>(1e-4) };
+
+                std::vector<TScalar> X0, Y0, X1, Y1;
+
+                ClippedSegments<TScalar> Output;
+
+                void Add(const double x0, const double y0, const double x1, const double y1)
+                {
+                    X0.push_back(static_cast<TScalar>(x0));
+                    Y0.push_back(static_cast<TScalar>(y0));
+                    X1.push_back(static_cast<TScalar>(x1));
+                    Y1.push_back(static_cast<TScalar>(y1));
+                }
+
+                SegmentArrays<TScalar> Segments() const
+                {
+                    return { X0.data(), Y0.data(), X1.data(), Y1.data(), X0.size() };
+                }
+
+                static ClipRect<TScalar> Rect(const double minX, const double minY, const double maxX, const double maxY)
+                {
+                    return {
+                        static_cast<TScalar>(minX), static_cast<TScalar>(minY),
+                        static_cast<TScalar>(maxX), static_cast<TScalar>(maxY)
+                    };
+                }
+
+                static TileGrid<TScalar> Grid(const std::uint32_t columns, const std::uint32_t rows)
+                {
+                    return { TScalar(0), TScalar(0), TScalar(10), TScalar(10), columns, rows };
+                }
+
+                std::size_t Clip(const ClipRect<TScalar>& rect, const ClipEdges edges)
+                {
+                    Output.Clear();
+                    return ClipSegments(Apx, Segments(), rect, edges, Output);
+                }
+
+                std::size_t ClipToGrid(const TileGrid<TScalar>& grid)
+                {
+                    Output.Clear();
+                    return ClipSegmentsToGrid(Apx, Segments(), grid, Output);
+                }
+
+                TVector2 Start(const std::size_t i) const { return TVector2(Output.X0[i], Output.Y0[i]); }
+
+                TVector2 End(const std::size_t i) const { return TVector2(Output.X1[i], Output.Y1[i]); }
+
+                bool ResultEquals(const std::size_t i, const double x0, const double y0, const double x1, const double y1) const
+                {
+                    return Apx.Zero(Start(i) - TVector2(x0, y0)) && Apx.Zero(End(i) - TVector2(x1, y1));
+                }
+
+                void ClipsCrossingSegment()
+                {
+                    Add(-5, 5, 15, 5);
+                    REQUIRE(Clip(Rect(0, 0, 10, 10), ClipEdges::Closed) == 1);
+                    REQUIRE(ResultEquals(0, 0, 5, 10, 5));
+                    REQUIRE(Output.Source[0] == 0);
+                    REQUIRE(Output.Tile.empty());
+                }
+
+                void KeepsInsideSegmentExact()
+                {
+                    Add(1.1, 2.2, 3.3, 4.4);
+                    REQUIRE(Clip(Rect(0, 0, 10, 10), ClipEdges::Closed) == 1);
+                    REQUIRE(Output.X0[0] == X0[0]);
+                    REQUIRE(Output.Y0[0] == Y0[0]);
+                    REQUIRE(Output.X1[0] == X1[0]);
+                    REQUIRE(Output.Y1[0] == Y1[0]);
+                }
+
+                void CompactsOutput()
+                {
+                    // More than one block, every third segment is inside:
+                    for (int i = 0; i < 200; i++)
+                    {
+                        double y = i % 3 == 0 ? 5 : 20;
+                        Add(-1, y, 11, y);
+                    }
+
+                    REQUIRE(Clip(Rect(0, 0, 10, 10), ClipEdges::Closed) == 67);
+
+                    for (std::size_t i = 0; i < Output.Size(); i++)
+                    {
+                        REQUIRE(Output.Source[i] == i * 3);
+                        REQUIRE(ResultEquals(i, 0, 5, 10, 5));
+                    }
+                }
+
+                void RejectsOutsideAndCornerTouching()
+                {
+                    Add(11, 0, 20, 10);
+                    Add(-5, 5, 5, 15);
+                    Add(0, 20, 20, 0);
+                    Add(-5, 4, 5, 14);
+                    REQUIRE(Clip(Rect(0, 0, 10, 10), ClipEdges::Closed) == 1);
+                    REQUIRE(Output.Source[0] == 3);
+                    REQUIRE(ResultEquals(0, 0, 9, 1, 10));
+                }
+
+                void EdgeSegment_DependsOnPolicy()
+                {
+                    Add(0, 10, 10, 10);
+                    Add(10, 0, 10, 10);
+                    Add(0, 0, 10, 0);
+                    Add(0, 2, 0, 8);
+
+                    REQUIRE(Clip(Rect(0, 0, 10, 10), ClipEdges::Closed) == 4);
+                    REQUIRE(Clip(Rect(0, 0, 10, 10), ClipEdges::HalfOpen) == 2);
+                    REQUIRE(Output.Source[0] == 2);
+                    REQUIRE(Output.Source[1] == 3);
+                }
+
+                void EdgeSegment_WithinEps_OwnedByExactlyOneTile()
+                {
+                    Add(2, 10.00005, 8, 9.99995);
+                    Add(10.00001, 2, 9.99999, 8);
+
+                    std::size_t lower = Clip(Rect(0, 0, 10, 10), ClipEdges::HalfOpen);
+                    std::size_t right = Clip(Rect(10, 0, 20, 10), ClipEdges::HalfOpen);
+                    std::size_t upper = Clip(Rect(0, 10, 10, 20), ClipEdges::HalfOpen);
+
+                    REQUIRE(lower == 0);
+                    REQUIRE(right == 1);
+                    REQUIRE(upper == 1);
+                }
+
+                void EdgeSegment_AtEdgeMinusEps_OwnedByExactlyOneTile()
+                {
+                    const TScalar x = TScalar(10) + (-Apx.Eps());
+                    Add(x, 2, x, 8);
+
+                    std::size_t left = Clip(Rect(0, 0, 10, 10), ClipEdges::HalfOpen);
+                    std::size_t right = Clip(Rect(10, 0, 20, 10), ClipEdges::HalfOpen);
+                    REQUIRE(left + right == 1);
+
+                    TileGrid<TScalar> grid = Grid(2, 1);
+                    REQUIRE(ClipToGrid(grid) == 1);
+                }
+
+                void NonFinite_Skipped()
+                {
+                    const TScalar inf = std::numeric_limits<TScalar>::infinity();
+                    const TScalar nan = std::numeric_limits<TScalar>::quiet_NaN();
+                    Add(inf, 5, 5, 6);
+                    Add(5, 5, 5, -inf);
+                    Add(-inf, 5, inf, 5);
+                    Add(nan, 5, 5, 6);
+                    Add(5, 5, 6, nan);
+                    Add(1, 1, 2, 2);
+
+                    REQUIRE(Clip(Rect(0, 0, 10, 10), ClipEdges::Closed) == 1);
+                    REQUIRE(Output.Source[0] == 5);
+                    REQUIRE(ResultEquals(0, 1, 1, 2, 2));
+                }
+
+                void PointSegment()
+                {
+                    Add(5, 5, 5, 5);
+                    Add(10, 10, 10, 10);
+                    REQUIRE(Clip(Rect(0, 0, 10, 10), ClipEdges::Closed) == 2);
+                    REQUIRE(Clip(Rect(0, 0, 10, 10), ClipEdges::HalfOpen) == 1);
+                }
+
+                void Grid_BinsIntoCrossedTiles()
+                {
+                    Add(1, 1, 29, 29);
+                    REQUIRE(ClipToGrid(Grid(3, 3)) == 3);
+
+                    for (std::uint32_t i = 0; i < 3; i++)
+                    {
+                        REQUIRE(Output.Tile[i] == i * 3 + i);
+                        REQUIRE(Output.Source[i] == 0);
+                    }
+
+                    REQUIRE(ResultEquals(0, 1, 1, 10, 10));
+                    REQUIRE(ResultEquals(1, 10, 10, 20, 20));
+                    REQUIRE(ResultEquals(2, 20, 20, 29, 29));
+
+                    // Pieces are connected bitwise:
+                    REQUIRE(Output.X1[0] == Output.X0[1]);
+                    REQUIRE(Output.Y1[1] == Output.Y0[2]);
+                }
+
+                void Grid_MatchesPerTileClipping()
+                {
+                    Add(-3, 4, 33, 17);
+                    Add(5, 25, 26, 2);
+                    Add(10, 0, 10, 30);
+                    Add(30, 30, 20, 30);
+                    Add(12, 13, 14, 15);
+                    Add(-5, -5, -1, -1);
+                    Add(0, 12, 30, 12.00001);
+
+                    // Near vertical and near horizontal (|d| < eps) segments within eps of shared edges,
+                    // crossing several rows or columns, some with the midpoint and one endpoint on different sides:
+                    Add(10 - 1.2e-4, 9, 10 - 0.3e-4, 29);
+                    Add(20 - 0.2e-4, 28, 20 - 1.15e-4, 9);
+                    Add(10 - 0.6e-4, 1, 10 + 0.3e-4, 29);
+                    Add(20 - 1.1e-4, 5, 20 - 0.5e-4, 25);
+                    Add(1, 20 - 1.2e-4, 29, 20 - 0.3e-4);
+                    Add(27, 10 + 1.1e-4, 4, 10 + 0.4e-4);
+                    Add(30 - 0.5e-4, 2, 30 + 0.2e-4, 30);
+
+                    const TileGrid<TScalar> grid = Grid(3, 3);
+                    ClipToGrid(grid);
+                    const ClippedSegments<TScalar> binned = Output;
+
+                    std::size_t total = 0;
+                    for (std::uint32_t row = 0; row < grid.Rows; row++)
+                    {
+                        for (std::uint32_t column = 0; column < grid.Columns; column++)
+                        {
+                            const std::uint32_t tile = row * grid.Columns + column;
+
+                            std::vector<std::size_t> pieces;
+                            for (std::size_t i = 0; i < binned.Size(); i++)
+                            {
+                                if (binned.Tile[i] == tile) pieces.push_back(i);
+                            }
+
+                            std::vector<std::size_t> expected;
+                            for (std::size_t i = 0; i < X0.size(); i++)
+                            {
+                                TScalar t0, t1;
+                                if (ClipSegment(
+                                    Apx, X0[i], Y0[i], X1[i], Y1[i], grid.Tile(column, row),
+                                    column == grid.Columns - 1, row == grid.Rows - 1, t0, t1))
+                                {
+                                    expected.push_back(i);
+
+                                    const std::size_t k = expected.size() - 1;
+                                    REQUIRE(k < pieces.size());
+                                    REQUIRE(binned.Source[pieces[k]] == i);
+                                    REQUIRE(Apx.Equals(binned.X0[pieces[k]], detail::Lerp(X0[i], X1[i], t0)));
+                                    REQUIRE(Apx.Equals(binned.Y0[pieces[k]], detail::Lerp(Y0[i], Y1[i], t0)));
+                                    REQUIRE(Apx.Equals(binned.X1[pieces[k]], detail::Lerp(X0[i], X1[i], t1)));
+                                    REQUIRE(Apx.Equals(binned.Y1[pieces[k]], detail::Lerp(Y0[i], Y1[i], t1)));
+                                }
+                            }
+
+                            REQUIRE(pieces.size() == expected.size());
+                            total += pieces.size();
+                        }
+                    }
+
+                    REQUIRE(total == binned.Size());
+
+                    // Vertical segment on the shared edge x=10 belongs to column 1 only:
+                    for (std::size_t i = 0; i < binned.Size(); i++)
+                    {
+                        if (binned.Source[i] == 2) REQUIRE(binned.Tile[i] % 3 == 1);
+                    }
+
+                    // Segment on the outer max edges of the grid is kept:
+                    std::size_t outer = 0;
+                    for (std::size_t i = 0; i < binned.Size(); i++)
+                    {
+                        if (binned.Source[i] == 3) outer++;
+                    }
+                    REQUIRE(outer == 1);
+                }
+
+                void Grid_NearVerticalOnEdge_KeepsEveryRow()
+                {
+                    // |dx| < eps, so the columns are decided by the midpoint, which is within eps of the edge x=10
+                    // while the part in row 0 is not:
+                    Add(10 - 1.2e-4, 9, 10 - 0.4e-4, 29);
+
+                    REQUIRE(ClipToGrid(Grid(4, 4)) == 3);
+                    REQUIRE(Output.Tile[0] == 1);
+                    REQUIRE(Output.Tile[1] == 5);
+                    REQUIRE(Output.Tile[2] == 9);
+                    REQUIRE(ResultEquals(0, 10 - 1.2e-4, 9, 10 - 1.16e-4, 10));
+                }
+
+                void Grid_CrossingThenInside_AllEmitted()
+                {
+                    // A segment crossing all tiles of the row, followed by a block of segments inside a single tile:
+                    Add(0, 5, 30, 5);
+                    for (int i = 0; i < 100; i++)
+                    {
+                        Add(1, 1, 2, 2);
+                    }
+
+                    REQUIRE(ClipToGrid(Grid(3, 3)) == 103);
+                    REQUIRE(Output.Source[2] == 0);
+                    REQUIRE(Output.Source[102] == 100);
+                    REQUIRE(Output.Tile[102] == 0);
+                }
+
+                void Grid_NaN_Skipped()
+                {
+                    const TScalar nan = std::numeric_limits<TScalar>::quiet_NaN();
+                    Add(nan, 5, 15, 5);
+                    Add(5, nan, 5, 15);
+                    Add(nan, nan, nan, nan);
+                    Add(1, 1, 2, 2);
+
+                    REQUIRE(ClipToGrid(Grid(3, 3)) == 1);
+                    REQUIRE(Output.Source[0] == 3);
+                }
+
+                void Grid_Invalid_Throws()
+                {
+                    Add(0, 0, 1, 1);
+                    TileGrid<TScalar> grid = Grid(3, 3);
+                    grid.TileWidth = 0;
+                    CHECK_THROWS(ClipToGrid(grid));
+                }
+
+                void Grid_NotRepresentable_Throws()
+                {
+                    Add(0, 0, 1, 1);
+                    TileGrid<TScalar> grid = Grid((1u << std::numeric_limits<TScalar>::digits) + 1, 1);
+                    CHECK_THROWS(ClipToGrid(grid));
+                }
+            };
+
+            namespace ClipSegments_
+            {
+                TEST_CASE_METHOD(SegmentClippingFixture<float>, "float | Clips crossing segment")
+                {
+                    ClipsCrossingSegment();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<double>, "double | Clips crossing segment")
+                {
+                    ClipsCrossingSegment();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<double>, "double | Keeps inside segment exact")
+                {
+                    KeepsInsideSegmentExact();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<float>, "float | Compacts output")
+                {
+                    CompactsOutput();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<double>, "double | Rejects outside and corner touching")
+                {
+                    RejectsOutsideAndCornerTouching();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<float>, "float | Edge segment depends on policy")
+                {
+                    EdgeSegment_DependsOnPolicy();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<double>, "double | Edge segment within eps owned by exactly one tile")
+                {
+                    EdgeSegment_WithinEps_OwnedByExactlyOneTile();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<float>, "float | Edge segment at (edge - eps) owned by exactly one tile")
+                {
+                    EdgeSegment_AtEdgeMinusEps_OwnedByExactlyOneTile();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<double>, "double | Edge segment at (edge - eps) owned by exactly one tile")
+                {
+                    EdgeSegment_AtEdgeMinusEps_OwnedByExactlyOneTile();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<float>, "float | Non-finite segments are skipped")
+                {
+                    NonFinite_Skipped();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<double>, "double | Non-finite segments are skipped")
+                {
+                    NonFinite_Skipped();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<double>, "double | Point segment")
+                {
+                    PointSegment();
+                }
+            }
+
+            namespace ClipSegmentsToGrid_
+            {
+                TEST_CASE_METHOD(SegmentClippingFixture<double>, "double | Bins into crossed tiles")
+                {
+                    Grid_BinsIntoCrossedTiles();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<float>, "float | Matches per tile clipping")
+                {
+                    Grid_MatchesPerTileClipping();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<double>, "double | Matches per tile clipping")
+                {
+                    Grid_MatchesPerTileClipping();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<float>, "float | Near vertical segment on edge keeps every row")
+                {
+                    Grid_NearVerticalOnEdge_KeepsEveryRow();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<double>, "double | Near vertical segment on edge keeps every row")
+                {
+                    Grid_NearVerticalOnEdge_KeepsEveryRow();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<float>, "float | Crossing then inside segments all emitted")
+                {
+                    Grid_CrossingThenInside_AllEmitted();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<float>, "float | NaN segments are skipped")
+                {
+                    Grid_NaN_Skipped();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<double>, "double | Invalid grid throws")
+                {
+                    Grid_Invalid_Throws();
+                }
+
+                TEST_CASE_METHOD(SegmentClippingFixture<float>, "float | Grid size not representable throws")
+                {
+                    Grid_NotRepresentable_Throws();
+                }
+            }
+        }
+    }
+}